@@ -15,8 +15,26 @@ inline static constexpr size_t CACHE_TAG_LEN = ADDRESS_LEN - CACHE_INDEX_LEN - C
 
 inline static constexpr size_t OpcodeLen = 7;
 
+inline static constexpr size_t PAGE_OFFSET_LEN = 12; // длина смещения внутри страницы Sv32 (в битах)
+inline static constexpr size_t PAGE_SIZE = 1 << PAGE_OFFSET_LEN; // размер страницы (в байтах)
+inline static constexpr size_t VPN_LEN = 10; // длина одной части VPN Sv32 (в битах)
+inline static constexpr size_t ITLB_ENTRY_COUNT = 16; // кол-во записей I-TLB
+inline static constexpr size_t ITLB_WAY = 4; // ассоциативность I-TLB
+inline static constexpr size_t DTLB_ENTRY_COUNT = 32; // кол-во записей D-TLB
+inline static constexpr size_t DTLB_WAY = 4; // ассоциативность D-TLB
+
+inline static constexpr size_t BP_TABLE_LEN = 12; // log2 кол-ва счётчиков bimodal/gshare/базы TAGE
+inline static constexpr size_t BTB_ENTRY_COUNT = 256; // кол-во записей BTB
+inline static constexpr size_t RAS_DEPTH = 16; // глубина стека адресов возврата
+
 
 
 enum class CRP {
     LRU, pLRU
-};
\ No newline at end of file
+};
+
+inline constexpr const char* GetPolicyName(CRP policy) {
+    return policy == CRP::LRU ? "LRU" : "bpLRU";
+}
+
+inline static constexpr CRP TLB_POLICY = CRP::LRU; // политика вытеснения в I-TLB и D-TLB
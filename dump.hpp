@@ -0,0 +1,154 @@
+#pragma once
+
+#include "const.hpp"
+#include "func.hpp"
+#include "stats.hpp"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace RiscV {
+
+// Сжатие блока в формате LZ4 block (совместим со стандартным декодером LZ4)
+class Lz4Compressor {
+private:
+    static constexpr size_t kHashLen = 12;
+    static constexpr size_t kMinMatch = 4;
+    static constexpr size_t kLastLiterals = 5;
+    static constexpr size_t kMatchLimit = 12; // последнее совпадение начинается не ближе к концу
+    static constexpr size_t kMaxOffset = 65535;
+
+    std::vector<int32_t> table_;
+
+    static uint32_t Read32(const uint8_t* ptr) {
+        uint32_t value;
+        std::memcpy(&value, ptr, sizeof(value));
+        return value;
+    }
+
+    static uint32_t Hash(uint32_t sequence) {
+        return (sequence * 2654435761U) >> (32 - kHashLen);
+    }
+
+    static void WriteLength(std::vector<uint8_t>& out, size_t len) {
+        while (len >= 255) {
+            out.push_back(255);
+            len -= 255;
+        }
+        out.push_back(static_cast<uint8_t>(len));
+    }
+
+    static void WriteSequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literal_len, size_t offset, size_t match_len) {
+        size_t token_match = match_len >= kMinMatch ? match_len - kMinMatch : 0;
+        uint8_t token = static_cast<uint8_t>((std::min<size_t>(literal_len, 15) << 4) | std::min<size_t>(token_match, 15));
+        out.push_back(token);
+        if (literal_len >= 15) {
+            WriteLength(out, literal_len - 15);
+        }
+        out.insert(out.end(), literals, literals + literal_len);
+        if (match_len == 0) {
+            return;
+        }
+        out.push_back(offset & 0xFF);
+        out.push_back(offset >> 8);
+        if (token_match >= 15) {
+            WriteLength(out, token_match - 15);
+        }
+    }
+
+public:
+    Lz4Compressor() : table_(1 << kHashLen) {};
+
+    void Compress(const uint8_t* src, size_t len, std::vector<uint8_t>& out) {
+        out.clear();
+        std::fill(table_.begin(), table_.end(), -1);
+        size_t anchor = 0;
+        size_t pos = 0;
+        if (len > kMatchLimit) {
+            size_t match_end = len - kMatchLimit;
+            while (pos < match_end) {
+                uint32_t sequence = Read32(src + pos);
+                uint32_t hash = Hash(sequence);
+                int32_t candidate = table_[hash];
+                table_[hash] = static_cast<int32_t>(pos);
+                if (candidate < 0 || pos - candidate > kMaxOffset || Read32(src + candidate) != sequence) {
+                    ++pos;
+                    continue;
+                }
+                size_t match_len = kMinMatch;
+                while (pos + match_len < len - kLastLiterals && src[candidate + match_len] == src[pos + match_len]) {
+                    ++match_len;
+                }
+                WriteSequence(out, src + anchor, pos - anchor, pos - candidate, match_len);
+                pos += match_len;
+                anchor = pos;
+            }
+        }
+        WriteSequence(out, src + anchor, len - anchor, 0, 0);
+    }
+};
+
+// Инкрементальный дамп: регистры и только изменённые страницы внутри заданных диапазонов.
+// Заголовок: "RVDM", флаги (1 — сжатие), 32 регистра, размер страницы.
+// Затем записи: адрес, длина, длина хранимых данных (== длина, если блок не сжат), данные.
+class DumpWriter {
+private:
+    static constexpr uint32_t kCompressed = 1;
+
+    BufferedWriter writer_;
+    bool compress_;
+    Lz4Compressor compressor_;
+    std::vector<uint8_t> block_;
+
+    void WriteBlock(const uint8_t* memory, uint32_t addres, uint32_t len) {
+        writer_.Write(addres);
+        writer_.Write(len);
+        if (compress_) {
+            compressor_.Compress(memory + addres, len, block_);
+            if (block_.size() < len) {
+                writer_.Write(static_cast<uint32_t>(block_.size()));
+                writer_.Write(block_.data(), block_.size());
+                return;
+            }
+        }
+        writer_.Write(len);
+        writer_.Write(memory + addres, len);
+    }
+
+public:
+    DumpWriter(const std::string& filename, bool compress) : writer_(filename), compress_(compress) {};
+
+    bool IsOpen() const {
+        return writer_.IsOpen();
+    }
+
+    void Write(const std::vector<uint32_t>& regs, const uint8_t* memory, const std::vector<bool>& dirty_pages, std::vector<std::pair<uint32_t, uint32_t>> ranges) {
+        writer_.Write("RVDM", 4);
+        writer_.Write(compress_ ? kCompressed : 0U);
+        for (size_t i = 0; i < 32; ++i) {
+            writer_.Write(regs[i]);
+        }
+        writer_.Write(static_cast<uint32_t>(PAGE_SIZE));
+
+        if (ranges.empty()) {
+            ranges.push_back({0, MEMORY_SIZE});
+        }
+        std::sort(ranges.begin(), ranges.end());
+        uint64_t written = 0; // всё до этого адреса уже записано
+        for (const auto& [addres, len] : ranges) {
+            uint64_t begin = std::max<uint64_t>(addres, written);
+            uint64_t end = std::min<uint64_t>(static_cast<uint64_t>(addres) + len, MEMORY_SIZE);
+            while (begin < end) {
+                uint64_t page_end = std::min<uint64_t>(((begin >> PAGE_OFFSET_LEN) + 1) << PAGE_OFFSET_LEN, end);
+                if (dirty_pages[begin >> PAGE_OFFSET_LEN]) {
+                    WriteBlock(memory, begin, page_end - begin);
+                }
+                begin = page_end;
+            }
+            written = std::max(written, end);
+        }
+        writer_.Flush();
+    }
+};
+}
@@ -3,15 +3,28 @@
 #include "const.hpp"
 #include <fstream>
 #include <vector>
+#include <string>
+#include <utility>
 
 namespace RiscV {
 
+class DumpWriter;
+
 struct DataToWrite {
     std::string filename = "";
     uint8_t* buff = nullptr;
     uint32_t len = 0;
     std::vector<uint32_t> regs;
     uint32_t addres = 0;
+    DumpWriter* dump = nullptr;
+    std::vector<std::pair<uint32_t, uint32_t>> dump_ranges;
+};
+
+struct Options {
+    bool classify_misses = false;
+    uint32_t satp = 0;
+    bool fuse = false;
+    bool fast_fetch = true;
 };
 
 uint32_t GetTag(uint32_t addres) {
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "const.hpp"
+#include "func.hpp"
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace RiscV {
+
+enum class FusionKind : uint8_t {
+    None, LuiAddi, AuipcJalr, SltBne, AddiBne
+};
+
+inline static constexpr size_t FUSION_KIND_COUNT = 4;
+
+// Пара (first, second) исполняется как одна суперинструкция, если second
+// использует результат first: lui+addi, auipc+jalr, slt[i][u]+bne, addi+bne.
+inline FusionKind MatchFusion(uint32_t first, uint32_t second) {
+    uint32_t opcode = GetOpcode(first);
+    uint32_t rd = GetRd(first);
+    if (rd == 0) {
+        return FusionKind::None;
+    }
+    uint32_t next_opcode = GetOpcode(second);
+    uint32_t next_funct3 = GetFunct3(second);
+    bool is_bne_on_rd = next_opcode == 0b1100011 && next_funct3 == 0b001 && (GetRs1(second) == rd || GetRs2(second) == rd);
+    if (opcode == 0b0110111) { // lui + addi
+        if (next_opcode == 0b0010011 && next_funct3 == 0b000 && GetRd(second) == rd && GetRs1(second) == rd) {
+            return FusionKind::LuiAddi;
+        }
+    } else if (opcode == 0b0010111) { // auipc + jalr
+        if (next_opcode == 0b1100111 && GetRs1(second) == rd) {
+            return FusionKind::AuipcJalr;
+        }
+    } else if (opcode == 0b0110011 && GetFunct7(first) == 0b0000000 && (GetFunct3(first) == 0b010 || GetFunct3(first) == 0b011)) { // slt/sltu + bne
+        if (is_bne_on_rd) {
+            return FusionKind::SltBne;
+        }
+    } else if (opcode == 0b0010011 && (GetFunct3(first) == 0b010 || GetFunct3(first) == 0b011)) { // slti/sltiu + bne
+        if (is_bne_on_rd) {
+            return FusionKind::SltBne;
+        }
+    } else if (opcode == 0b0010011 && GetFunct3(first) == 0b000) { // addi + bne
+        if (is_bne_on_rd) {
+            return FusionKind::AddiBne;
+        }
+    }
+    return FusionKind::None;
+}
+
+// Предекодированные пары по физическим адресам слов. Запись в память сбрасывает
+// затронутые пары, чтобы самомодифицирующийся код исполнялся без слияния.
+class FusionTable {
+private:
+    std::vector<FusionKind> kinds_;
+    std::array<size_t, FUSION_KIND_COUNT> hits_;
+
+public:
+    FusionTable() : hits_{} {};
+
+    // Таблица заводится только при включённом слиянии
+    void Build(const uint8_t* memory) {
+        kinds_.assign(MEMORY_SIZE / sizeof(uint32_t), FusionKind::None);
+        for (size_t i = 0; i + 1 < kinds_.size(); ++i) {
+            if ((i + 1) % (PAGE_SIZE / sizeof(uint32_t)) == 0) { // пара не пересекает границу страницы
+                continue;
+            }
+            uint32_t first, second;
+            std::memcpy(&first, memory + i * sizeof(uint32_t), sizeof(uint32_t));
+            std::memcpy(&second, memory + (i + 1) * sizeof(uint32_t), sizeof(uint32_t));
+            kinds_[i] = MatchFusion(first, second);
+        }
+    }
+
+    FusionKind GetKind(uint32_t addres) const {
+        return kinds_[addres >> 2];
+    }
+
+    void Invalidate(uint32_t addres, uint32_t size) {
+        size_t begin = addres >> 2;
+        size_t end = std::min<size_t>((addres + size - 1) >> 2, kinds_.size() - 1);
+        if (begin > 0) {
+            --begin;
+        }
+        for (size_t i = begin; i <= end; ++i) {
+            kinds_[i] = FusionKind::None;
+        }
+    }
+
+    void CountHit(FusionKind kind) {
+        ++hits_[static_cast<size_t>(kind) - 1];
+    }
+
+    void PrintStats(CRP policy) const {
+        printf("%11s\tfused\tlui+addi %zu\tauipc+jalr %zu\tslt+bne %zu\taddi+bne %zu\n", GetPolicyName(policy), hits_[0], hits_[1], hits_[2], hits_[3]);
+    }
+};
+}
@@ -1,12 +1,12 @@
 #include <iostream>
 #include <string>
 #include <cstring>
+#include <vector>
+#include <utility>
 
 
 namespace ERRORS {
     const std::string kErrorOrder = "Неправильное количество аргументов\n";
-    const uint8_t kCountArgs_1 = 3;
-    const uint8_t kCountArgs_2 = 7;
 }
 
 struct Data {
@@ -14,6 +14,17 @@ struct Data {
     std::string filename2 = "";
     uint32_t begin_addres = 0;
     uint32_t size = 0;
+    bool classify_misses = false;
+    uint32_t satp = 0;
+    bool predict_branches = false;
+    std::string stats_filename = "";
+    uint64_t stats_period = 0;
+    bool stats_by_access = false;
+    bool fuse = false;
+    bool fast_fetch = true;
+    std::string dump_filename = "";
+    std::vector<std::pair<uint32_t, uint32_t>> dump_ranges;
+    bool compress = false;
     bool error = false;
     std::string error_name = "";
 };
@@ -22,19 +33,50 @@ class Parser {
 public:
     Data Parse(int argc, char* argv[]) {
         Data data;
-        if (argc != ERRORS::kCountArgs_1 && argc != ERRORS::kCountArgs_2) {
-            data.error = 1;
-            data.error_name = ERRORS::kErrorOrder;
-        }
         for (int i = 1; i < argc; ++i) {
-            if (strcmp(argv[i], "-i") == 0) {
+            if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
                 data.filename1 = argv[++i];
-            } else if (strcmp(argv[i], "-o") == 0) {
+            } else if (strcmp(argv[i], "-o") == 0 && i + 3 < argc) {
                 data.filename2 = argv[++i];
                 data.begin_addres = std::stoul(argv[++i], 0, 16);
                 data.size = std::stoul(argv[++i]);
+            } else if (strcmp(argv[i], "-c") == 0) { // классификация промахов (compulsory/capacity/conflict)
+                data.classify_misses = true;
+            } else if (strcmp(argv[i], "-vm") == 0 && i + 1 < argc) { // значение satp, MODE = 1 включает Sv32
+                data.satp = std::stoul(argv[++i], 0, 16);
+            } else if (strcmp(argv[i], "-bp") == 0) { // статистика предсказателей переходов
+                data.predict_branches = true;
+            } else if ((strcmp(argv[i], "-stats") == 0 || strcmp(argv[i], "-stats-acc") == 0) && i + 2 < argc) { // снимки каждые N инструкций / обращений
+                data.stats_by_access = strcmp(argv[i], "-stats-acc") == 0;
+                data.stats_filename = argv[++i];
+                data.stats_period = std::stoull(argv[++i]);
+                if (data.stats_period == 0) {
+                    data.error = 1;
+                }
+            } else if (strcmp(argv[i], "-slow-fetch") == 0) { // выборка без быстрого пути (для сверки статистики)
+                data.fast_fetch = false;
+            } else if (strcmp(argv[i], "-fuse") == 0) { // слияние частых пар инструкций
+                data.fuse = true;
+            } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) { // инкрементальный дамп изменённых страниц
+                data.dump_filename = argv[++i];
+            } else if (strcmp(argv[i], "-r") == 0 && i + 2 < argc) { // диапазон памяти для дампа
+                uint32_t addres = std::stoul(argv[++i], 0, 16);
+                data.dump_ranges.push_back({addres, static_cast<uint32_t>(std::stoul(argv[++i]))});
+            } else if (strcmp(argv[i], "-z") == 0) { // сжатие блоков дампа LZ4
+                data.compress = true;
+            } else {
+                data.error = 1;
             }
         }
+        if (data.filename1 == "") {
+            data.error = 1;
+        }
+        if (data.dump_filename == "" && (!data.dump_ranges.empty() || data.compress)) { // -r и -z имеют смысл только с -d
+            data.error = 1;
+        }
+        if (data.error) {
+            data.error_name = ERRORS::kErrorOrder;
+        }
         return data;
     }
 };
\ No newline at end of file
@@ -0,0 +1,353 @@
+#pragma once
+
+#include "const.hpp"
+#include <array>
+#include <vector>
+#include <tuple>
+#include <utility>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdio>
+
+namespace RiscV {
+
+// Насыщающийся счётчик: Taken, если значение >= Max / 2 + 1
+template <uint8_t Max>
+void UpdateCounter(uint8_t& counter, bool taken) {
+    if (taken && counter < Max) {
+        ++counter;
+    } else if (!taken && counter > 0) {
+        --counter;
+    }
+}
+
+// Все предсказатели направления: Predict(pc, target) и затем Update(pc, taken) для той же инструкции.
+
+class StaticBtfn {
+public:
+    static constexpr const char* kName = "static BTFN";
+
+    bool Predict(uint32_t pc, uint32_t target) {
+        return target < pc;
+    }
+
+    void Update(uint32_t, bool) {}
+};
+
+class Bimodal {
+private:
+    std::vector<uint8_t> table_;
+
+    uint32_t GetIndex(uint32_t pc) const {
+        return (pc >> 2) & ((1UL << BP_TABLE_LEN) - 1UL);
+    }
+
+public:
+    static constexpr const char* kName = "bimodal";
+
+    Bimodal() : table_(1 << BP_TABLE_LEN, 1) {};
+
+    bool Predict(uint32_t pc, uint32_t) {
+        return table_[GetIndex(pc)] >= 2;
+    }
+
+    void Update(uint32_t pc, bool taken) {
+        UpdateCounter<3>(table_[GetIndex(pc)], taken);
+    }
+};
+
+class Gshare {
+private:
+    std::vector<uint8_t> table_;
+    uint32_t history_;
+
+    uint32_t GetIndex(uint32_t pc) const {
+        return ((pc >> 2) ^ history_) & ((1UL << BP_TABLE_LEN) - 1UL);
+    }
+
+public:
+    static constexpr const char* kName = "gshare";
+
+    Gshare() : table_(1 << BP_TABLE_LEN, 1), history_(0) {};
+
+    bool Predict(uint32_t pc, uint32_t) {
+        return table_[GetIndex(pc)] >= 2;
+    }
+
+    void Update(uint32_t pc, bool taken) {
+        UpdateCounter<3>(table_[GetIndex(pc)], taken);
+        history_ = ((history_ << 1) | taken) & ((1UL << BP_TABLE_LEN) - 1UL);
+    }
+};
+
+// Упрощённый TAGE: базовый бимодальный предсказатель и 4 таблицы с тегами
+// на геометрически растущих длинах глобальной истории.
+class TageLite {
+private:
+    static constexpr int kTableCount = 4;
+    static constexpr size_t kIndexLen = 8;
+    static constexpr size_t kTagLen = 8;
+    static constexpr std::array<uint32_t, kTableCount> kHistoryLen = {4, 8, 16, 32};
+    static constexpr size_t kResetPeriod = 1 << 18;
+
+    struct Entry {
+        bool is_valid = false;
+        uint8_t tag = 0;
+        uint8_t ctr = 3; // 3-битный счётчик, Taken при ctr >= 4
+        uint8_t useful = 0;
+    };
+
+    std::vector<uint8_t> base_;
+    std::array<std::vector<Entry>, kTableCount> tables_;
+    uint64_t history_;
+    size_t branch_cnt_;
+
+    // Результат последнего Predict, используется в Update
+    std::array<uint32_t, kTableCount> index_;
+    std::array<uint8_t, kTableCount> tag_;
+    int provider_, alt_;
+    bool provider_pred_, alt_pred_;
+
+    static uint32_t Fold(uint64_t history, uint32_t len, uint32_t width) {
+        if (len < 64) {
+            history &= (1ULL << len) - 1ULL;
+        }
+        uint32_t result = 0;
+        while (history != 0) {
+            result ^= history & ((1UL << width) - 1UL);
+            history >>= width;
+        }
+        return result;
+    }
+
+    uint32_t GetBaseIndex(uint32_t pc) const {
+        return (pc >> 2) & ((1UL << BP_TABLE_LEN) - 1UL);
+    }
+
+public:
+    static constexpr const char* kName = "TAGE-lite";
+
+    TageLite() : base_(1 << BP_TABLE_LEN, 1), history_(0), branch_cnt_(0), provider_(-1), alt_(-1), provider_pred_(false), alt_pred_(false) {
+        for (auto& table : tables_) {
+            table.resize(1 << kIndexLen);
+        }
+    };
+
+    bool Predict(uint32_t pc, uint32_t) {
+        provider_ = -1;
+        alt_ = -1;
+        for (int i = 0; i < kTableCount; ++i) {
+            uint32_t folded = Fold(history_, kHistoryLen[i], kIndexLen);
+            index_[i] = ((pc >> 2) ^ (pc >> (2 + kIndexLen)) ^ folded) & ((1UL << kIndexLen) - 1UL);
+            tag_[i] = ((pc >> 2) ^ (Fold(history_, kHistoryLen[i], kTagLen - 1) << 1)) & ((1UL << kTagLen) - 1UL);
+        }
+        for (int i = kTableCount - 1; i >= 0; --i) {
+            const Entry& entry = tables_[i][index_[i]];
+            if (entry.is_valid && entry.tag == tag_[i]) {
+                if (provider_ == -1) {
+                    provider_ = i;
+                } else {
+                    alt_ = i;
+                    break;
+                }
+            }
+        }
+        alt_pred_ = alt_ == -1 ? base_[GetBaseIndex(pc)] >= 2 : tables_[alt_][index_[alt_]].ctr >= 4;
+        provider_pred_ = provider_ == -1 ? alt_pred_ : tables_[provider_][index_[provider_]].ctr >= 4;
+        return provider_pred_;
+    }
+
+    void Update(uint32_t pc, bool taken) {
+        if (provider_ == -1) {
+            UpdateCounter<3>(base_[GetBaseIndex(pc)], taken);
+        } else {
+            Entry& entry = tables_[provider_][index_[provider_]];
+            UpdateCounter<7>(entry.ctr, taken);
+            if (provider_pred_ != alt_pred_) {
+                UpdateCounter<3>(entry.useful, provider_pred_ == taken);
+            }
+        }
+        if (provider_pred_ != taken && provider_ < kTableCount - 1) {
+            bool allocated = false;
+            for (int i = provider_ + 1; i < kTableCount; ++i) {
+                Entry& entry = tables_[i][index_[i]];
+                if (entry.useful == 0) {
+                    entry.is_valid = true;
+                    entry.tag = tag_[i];
+                    entry.ctr = taken ? 4 : 3;
+                    allocated = true;
+                    break;
+                }
+            }
+            if (!allocated) {
+                for (int i = provider_ + 1; i < kTableCount; ++i) {
+                    UpdateCounter<3>(tables_[i][index_[i]].useful, false);
+                }
+            }
+        }
+        if (++branch_cnt_ % kResetPeriod == 0) {
+            for (auto& table : tables_) {
+                for (auto& entry : table) {
+                    entry.useful >>= 1;
+                }
+            }
+        }
+        history_ = (history_ << 1) | taken;
+    }
+};
+
+class Btb {
+private:
+    struct Entry {
+        bool is_valid = false;
+        uint32_t pc = 0;
+        uint32_t target = 0;
+    };
+
+    std::array<Entry, BTB_ENTRY_COUNT> entries_;
+
+public:
+    bool Predict(uint32_t pc, uint32_t target) const {
+        const Entry& entry = entries_[(pc >> 2) % BTB_ENTRY_COUNT];
+        return entry.is_valid && entry.pc == pc && entry.target == target;
+    }
+
+    void Update(uint32_t pc, uint32_t target) {
+        entries_[(pc >> 2) % BTB_ENTRY_COUNT] = {true, pc, target};
+    }
+};
+
+class ReturnStack {
+private:
+    std::array<uint32_t, RAS_DEPTH> stack_;
+    size_t top_;
+
+public:
+    ReturnStack() : stack_{}, top_(0) {};
+
+    void Push(uint32_t addres) {
+        stack_[top_ % RAS_DEPTH] = addres;
+        ++top_;
+    }
+
+    uint32_t Pop() {
+        if (top_ == 0) {
+            return 0;
+        }
+        --top_;
+        return stack_[top_ % RAS_DEPTH];
+    }
+};
+
+// Все модели оцениваются одновременно на одной трассе переходов
+template <typename... Predictors>
+class BranchUnit {
+private:
+    static constexpr size_t kCount = sizeof...(Predictors);
+    static constexpr size_t kWorstCount = 5;
+
+    struct BranchStats {
+        size_t cnt = 0;
+        std::array<size_t, kCount> misses{};
+    };
+
+    std::tuple<Predictors...> predictors_;
+    std::array<size_t, kCount> correct_;
+    std::unordered_map<uint32_t, BranchStats> stats_;
+    size_t branch_cnt_;
+    Btb btb_;
+    ReturnStack ras_;
+    size_t btb_hits_, btb_cnt_, ras_hits_, ras_cnt_;
+
+    static bool IsLink(uint32_t reg) {
+        return reg == 1 || reg == 5;
+    }
+
+    static void PrintAccuracy(const char* name, size_t hits, size_t cnt) {
+        if (cnt == 0) {
+            printf("%11s\tn/a\n", name);
+            return;
+        }
+        printf("%11s\t%3.5f%%\n", name, 100.0 * hits / cnt);
+    }
+
+    void UpdateBtb(uint32_t pc, uint32_t target) {
+        ++btb_cnt_;
+        if (btb_.Predict(pc, target)) {
+            ++btb_hits_;
+        }
+        btb_.Update(pc, target);
+    }
+
+    template <size_t... I>
+    void Evaluate(uint32_t pc, uint32_t target, bool taken, BranchStats& stats, std::index_sequence<I...>) {
+        ((std::get<I>(predictors_).Predict(pc, target) == taken ? ++correct_[I] : ++stats.misses[I]), ...);
+        (std::get<I>(predictors_).Update(pc, taken), ...);
+    }
+
+public:
+    BranchUnit() : correct_{}, branch_cnt_(0), btb_hits_(0), btb_cnt_(0), ras_hits_(0), ras_cnt_(0) {};
+
+    void Branch(uint32_t pc, uint32_t target, bool taken) {
+        BranchStats& stats = stats_[pc];
+        ++stats.cnt;
+        ++branch_cnt_;
+        Evaluate(pc, target, taken, stats, std::index_sequence_for<Predictors...>{});
+        if (taken) {
+            UpdateBtb(pc, target);
+        }
+    }
+
+    void Jump(uint32_t pc, uint32_t target, uint32_t rd, uint32_t rs1, bool is_indirect) {
+        bool is_return = is_indirect && IsLink(rs1) && (!IsLink(rd) || rd != rs1);
+        if (is_return) {
+            ++ras_cnt_;
+            if (ras_.Pop() == target) {
+                ++ras_hits_;
+            }
+        } else {
+            UpdateBtb(pc, target);
+        }
+        if (IsLink(rd)) {
+            ras_.Push(pc + 4);
+        }
+    }
+
+    void PrintStats() {
+        printf("predictor\taccuracy\n");
+        size_t i = 0;
+        std::apply([&](auto&... predictor) {
+            ((PrintAccuracy(predictor.kName, correct_[i], branch_cnt_), ++i), ...);
+        }, predictors_);
+        PrintAccuracy("BTB", btb_hits_, btb_cnt_);
+        PrintAccuracy("RAS", ras_hits_, ras_cnt_);
+
+        std::vector<std::pair<uint32_t, BranchStats>> worst(stats_.begin(), stats_.end());
+        auto total = [](const BranchStats& stats) {
+            size_t sum = 0;
+            for (size_t misses : stats.misses) {
+                sum += misses;
+            }
+            return sum;
+        };
+        std::sort(worst.begin(), worst.end(), [&](const auto& lhs, const auto& rhs) {
+            return total(lhs.second) > total(rhs.second);
+        });
+        worst.resize(std::min(worst.size(), kWorstCount));
+        printf("branch pc\tcount");
+        std::apply([](auto&... predictor) {
+            (printf("\t%s", predictor.kName), ...);
+        }, predictors_);
+        printf("\n");
+        for (const auto& [pc, stats] : worst) {
+            printf("0x%08x\t%zu", pc, stats.cnt);
+            for (size_t misses : stats.misses) {
+                printf("\t%zu", misses);
+            }
+            printf("\n");
+        }
+    }
+};
+
+using BranchPredictors = BranchUnit<StaticBtfn, Bimodal, Gshare, TageLite>;
+}
@@ -4,9 +4,16 @@
 #include "func.hpp"
 #include "bin_parser.hpp"
 #include "parser.hpp"
+#include "predictor.hpp"
+#include "stats.hpp"
+#include "fusion.hpp"
+#include "dump.hpp"
 #include <vector>
 #include <array>
 #include <list>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
 #include <algorithm>
 #include <cstdio>
 #include <string>
@@ -16,9 +23,10 @@ namespace RiscV {
 class RAM {
 private:
     std::vector<uint8_t> ram_;
+    std::vector<bool> dirty_pages_; // страницы, изменённые относительно загруженного образа
 
 public:
-    RAM(const std::vector<fragment>& frag) : ram_(MEMORY_SIZE) {
+    RAM(const std::vector<fragment>& frag) : ram_(MEMORY_SIZE), dirty_pages_(MEMORY_SIZE / PAGE_SIZE) {
         for (const auto& el : frag) {
             for (int i = 0; i < el.data.size(); ++i) {
                 ram_[el.addres + i] = el.data[i];
@@ -34,11 +42,16 @@ public:
 
     void WriteRAM(uint32_t addres, std::array<uint8_t, CACHE_LINE_SIZE> data) {
         std::copy(data.begin(), data.begin() + CACHE_LINE_SIZE, ram_.begin() + addres);
+        dirty_pages_[addres >> PAGE_OFFSET_LEN] = true;
     }
 
     uint8_t* GetData() {
         return ram_.data();
     }
+
+    const std::vector<bool>& GetDirtyPages() const {
+        return dirty_pages_;
+    }
 };
 
 class CacheLine {
@@ -75,8 +88,9 @@ public:
 
 class LruPolicy {
 public:
-    static uint32_t GetNextLine(std::array<CacheLine, CACHE_WAY>& lines, std::list<uint32_t>& lru_list) {
-        if (lru_list.size() < CACHE_WAY) {
+    template <typename Line, size_t Way>
+    static uint32_t GetNextLine(std::array<Line, Way>& lines, std::list<uint32_t>& lru_list) {
+        if (lru_list.size() < Way) {
             return lru_list.size();
         }
         return lru_list.front();
@@ -90,8 +104,9 @@ public:
 
 class bpLruPolicy {
 public:
-    static uint32_t GetNextLine(std::array<CacheLine, CACHE_WAY>& lines) {
-        for (size_t i = 0; i < CACHE_WAY; ++i) {
+    template <typename Line, size_t Way>
+    static uint32_t GetNextLine(std::array<Line, Way>& lines) {
+        for (size_t i = 0; i < Way; ++i) {
             if (!lines[i].plru) {
                 return i;                                                                   
             }
@@ -99,17 +114,18 @@ public:
         return 0;
     }
 
-    static void UpdateLines(uint32_t line, std::array<CacheLine, CACHE_WAY>& lines) {
+    template <typename Line, size_t Way>
+    static void UpdateLines(uint32_t line, std::array<Line, Way>& lines) {
         lines[line].plru = true;
         bool all_busy = true;
-        for (uint32_t i = 0; i < CACHE_WAY; ++i) {
+        for (uint32_t i = 0; i < Way; ++i) {
             if (!lines[i].plru) {
                 all_busy = false;
                 
             }
         }
         if (all_busy) {
-            for (uint32_t i = 0; i < CACHE_WAY; ++i) {
+            for (uint32_t i = 0; i < Way; ++i) {
                 lines[i].plru = false;
             }
         }   
@@ -117,6 +133,93 @@ public:
     }
 };
 
+enum class MissType {
+    Compulsory, Capacity, Conflict
+};
+
+// Теневой полностью ассоциативный LRU-кэш того же объёма для классификации промахов (3C).
+// Список LRU интрузивный, поиск линии через хеш-таблицу — обращение за O(1).
+class MissClassifier {
+private:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    struct Node {
+        uint32_t line;
+        uint32_t prev;
+        uint32_t next;
+    };
+
+    std::array<Node, CACHE_LINE_COUNT> nodes_;
+    std::unordered_map<uint32_t, uint32_t> where_;
+    std::unordered_set<uint32_t> seen_;
+    uint32_t head_, tail_, size_;
+
+    void Unlink(uint32_t idx) {
+        Node& node = nodes_[idx];
+        if (node.prev != kNone) {
+            nodes_[node.prev].next = node.next;
+        } else {
+            head_ = node.next;
+        }
+        if (node.next != kNone) {
+            nodes_[node.next].prev = node.prev;
+        } else {
+            tail_ = node.prev;
+        }
+    }
+
+    void PushFront(uint32_t idx) {
+        nodes_[idx].prev = kNone;
+        nodes_[idx].next = head_;
+        if (head_ != kNone) {
+            nodes_[head_].prev = idx;
+        } else {
+            tail_ = idx;
+        }
+        head_ = idx;
+    }
+
+public:
+    MissClassifier() : head_(kNone), tail_(kNone), size_(0) {
+        where_.reserve(2 * CACHE_LINE_COUNT);
+        seen_.reserve(MEMORY_SIZE / CACHE_LINE_SIZE);
+    };
+
+    // Обращение к линии в теневом кэше, возвращает true при попадании
+    bool Access(uint32_t line) {
+        if (head_ != kNone && nodes_[head_].line == line) { // повторное обращение к MRU, состояние не меняется
+            return true;
+        }
+        auto it = where_.find(line);
+        if (it != where_.end()) {
+            if (it->second != head_) {
+                Unlink(it->second);
+                PushFront(it->second);
+            }
+            return true;
+        }
+        uint32_t idx;
+        if (size_ < CACHE_LINE_COUNT) {
+            idx = size_++;
+        } else {
+            idx = tail_;
+            where_.erase(nodes_[idx].line);
+            Unlink(idx);
+        }
+        nodes_[idx].line = line;
+        where_.emplace(line, idx);
+        PushFront(idx);
+        return false;
+    }
+
+    MissType Classify(uint32_t line, bool shadow_hit) {
+        if (seen_.insert(line).second) {
+            return MissType::Compulsory;
+        }
+        return shadow_hit ? MissType::Conflict : MissType::Capacity;
+    }
+};
+
 template<CRP T> 
 class CacheSet;
 
@@ -205,7 +308,16 @@ template<CRP T>
 class CacheController {
 private:
     std::array<CacheSet<T>, CACHE_SET_COUNT> data;
-    size_t hits_inst_, hits_data_, inst_cnt_, data_cnt_;
+    uint64_t hits_inst_, hits_data_, inst_cnt_, data_cnt_;
+    bool classify_;
+    bool fast_fetch_;
+    MissClassifier shadow_;
+    std::array<size_t, 3> miss_inst_, miss_data_;
+    // Линия, из которой идёт выборка инструкций: пока PC в ней и к её набору не было
+    // других обращений, она MRU, и повторное попадание не меняет состояние LRU/bpLRU.
+    CacheLine* fetch_line_;
+    uint32_t fetch_line_addres_;
+    uint32_t fetch_index_;
 
     void UpdateСnt(bool is_data) {
         if (is_data) {
@@ -223,6 +335,15 @@ private:
         }
     }
 
+    void ClassifyAccess(uint32_t addres, bool is_data, bool is_hit) {
+        uint32_t line = addres >> CACHE_OFFSET_LEN;
+        bool shadow_hit = shadow_.Access(line);
+        if (!is_hit) {
+            auto& misses = is_data ? miss_data_ : miss_inst_;
+            ++misses[static_cast<size_t>(shadow_.Classify(line, shadow_hit))];
+        }
+    }
+
     void WriteBackLine(auto& set, uint32_t line, uint32_t index, RAM& ram) {
         if (set.IsDirty(line) && set.IsValid(line)) {
             uint32_t old_addr = (set.lines[line].tag << (CACHE_INDEX_LEN + CACHE_OFFSET_LEN)) | (index << CACHE_OFFSET_LEN);
@@ -238,8 +359,29 @@ private:
         return new_line;
     }
 
+    uint32_t FindLine(auto& set, uint32_t tag, uint32_t index, uint32_t addres, bool is_data, RAM& ram) {
+        uint32_t ind;
+        UpdateСnt(is_data);
+        bool is_hit = set.IsHit(tag, ind);
+        if (is_hit) {
+            UpdateHits(is_data);
+        } else {
+            ind = UpdateLine(set, tag, index, ram);
+        }
+        if (classify_) {
+            ClassifyAccess(addres, is_data, is_hit);
+        }
+        return ind;
+    }
+
+    void ResetFetchLine(uint32_t index) {
+        if (index == fetch_index_) {
+            fetch_line_addres_ = UINT32_MAX;
+        }
+    }
+
 public:
-    CacheController() : hits_inst_(0), hits_data_(0), inst_cnt_(0), data_cnt_(0) {};
+    CacheController(bool classify = false, bool fast_fetch = true) : hits_inst_(0), hits_data_(0), inst_cnt_(0), data_cnt_(0), classify_(classify), fast_fetch_(fast_fetch), miss_inst_{}, miss_data_{}, fetch_line_(nullptr), fetch_line_addres_(UINT32_MAX), fetch_index_(UINT32_MAX) {};
 
     template<typename U>
     U ReadFromCache(uint32_t addres, bool is_data, RAM& ram) {
@@ -247,13 +389,8 @@ public:
         uint32_t index = GetInd(addres);
         uint32_t offset = GetOffset(addres);
         auto& curr_set = data[index];
-        uint32_t ind;
-        UpdateСnt(is_data);
-        if (curr_set.IsHit(tag, ind)) {
-            UpdateHits(is_data);
-        } else {
-            ind = UpdateLine(curr_set, tag, index, ram);
-        }
+        ResetFetchLine(index);
+        uint32_t ind = FindLine(curr_set, tag, index, addres, is_data, ram);
         return curr_set.template Read<U>(ind, tag, offset);
     }    
 
@@ -263,17 +400,35 @@ public:
         uint32_t index = GetInd(addres);
         uint32_t offset = GetOffset(addres);
         auto& curr_set = data[index];
-        uint32_t ind;
-        UpdateСnt(is_data);
-        if (curr_set.IsHit(tag, ind)) {
-            UpdateHits(is_data);
-        } else {
-            ind = UpdateLine(curr_set, tag, index, ram);
-        }
+        ResetFetchLine(index);
+        uint32_t ind = FindLine(curr_set, tag, index, addres, is_data, ram);
         curr_set.template Write<U>(ind, tag, offset, value);
     }
 
+    uint32_t FetchFromCache(uint32_t addres, RAM& ram) {
+        uint32_t offset = GetOffset(addres);
+        if ((addres >> CACHE_OFFSET_LEN) == fetch_line_addres_) {
+            UpdateСnt(false);
+            UpdateHits(false);
+            if (classify_) {
+                ClassifyAccess(addres, false, true);
+            }
+            return fetch_line_->template ReadCacheLine<uint32_t>(offset);
+        }
+        uint32_t tag = GetTag(addres);
+        uint32_t index = GetInd(addres);
+        auto& curr_set = data[index];
+        uint32_t ind = FindLine(curr_set, tag, index, addres, false, ram);
+        if (fast_fetch_) {
+            fetch_line_ = &curr_set.lines[ind];
+            fetch_line_addres_ = addres >> CACHE_OFFSET_LEN;
+            fetch_index_ = index;
+        }
+        return curr_set.template Read<uint32_t>(ind, tag, offset);
+    }
+
     void ClearCache(RAM& ram) {
+        fetch_line_addres_ = UINT32_MAX;
         for (uint32_t i = 0; i < CACHE_SET_COUNT; ++i) {
             auto& curr_set = data[i];
             for (uint32_t j = 0; j < CACHE_WAY; ++j) {
@@ -286,28 +441,346 @@ public:
         }
     }
 
+    CacheCounters GetCounters() const {
+        return {hits_inst_, hits_data_, inst_cnt_, data_cnt_};
+    }
+
     void PrintRate();
+
+    void PrintMissClasses() {
+        const char* name = GetPolicyName(T);
+        printf("%11s\tmisses (inst)\tcompulsory %zu\tcapacity %zu\tconflict %zu\n", name, miss_inst_[0], miss_inst_[1], miss_inst_[2]);
+        printf("%11s\tmisses (data)\tcompulsory %zu\tcapacity %zu\tconflict %zu\n", name, miss_data_[0], miss_data_[1], miss_data_[2]);
+    }
 };
 
 template<>
 void CacheController<CRP::LRU>::PrintRate()  {
-    printf("        LRU\t%3.5f%%\t%3.5f%%\t%3.5f%%\n", std::abs((100.0 * (hits_data_ + hits_inst_)) / (inst_cnt_ + data_cnt_)), std::abs(100.0 * hits_inst_ / inst_cnt_), std::abs(100.0 * hits_data_ / data_cnt_));
+    printf("        LRU\t%3.5f%%\t%3.5f%%\t%3.5f%%", std::abs((100.0 * (hits_data_ + hits_inst_)) / (inst_cnt_ + data_cnt_)), std::abs(100.0 * hits_inst_ / inst_cnt_), std::abs(100.0 * hits_data_ / data_cnt_));
 }
 
 template<>
 void CacheController<CRP::pLRU>::PrintRate() {
-    printf("      bpLRU\t%3.5f%%\t%3.5f%%\t%3.5f%%\n", std::abs((100.0 * (hits_data_ + hits_inst_)) / (inst_cnt_ + data_cnt_)), std::abs(100.0 * hits_inst_ / inst_cnt_), std::abs(100.0 * hits_data_ / data_cnt_));
+    printf("      bpLRU\t%3.5f%%\t%3.5f%%\t%3.5f%%", std::abs((100.0 * (hits_data_ + hits_inst_)) / (inst_cnt_ + data_cnt_)), std::abs(100.0 * hits_inst_ / inst_cnt_), std::abs(100.0 * hits_data_ / data_cnt_));
 }
 
+enum class Access {
+    Fetch, Load, Store
+};
+
+// level = 1 — мегастраница 4 МиБ: vpn хранит только VPN[1], ppn — начало мегастраницы
+struct TlbEntry {
+    bool is_valid = false;
+    bool plru = false;
+    uint32_t level = 0;
+    uint32_t vpn = 0;
+    uint32_t ppn = 0;
+    uint32_t flags = 0;
+
+    uint32_t GetPpn(uint32_t full_vpn) const {
+        return level == 1 ? ppn | (full_vpn & ((1UL << VPN_LEN) - 1UL)) : ppn;
+    }
+};
+
+template<size_t Entries, size_t Way, CRP P>
+class Tlb {
+private:
+    static constexpr size_t kSetCount = Entries / Way;
+    static_assert((kSetCount & (kSetCount - 1)) == 0, "TLB set count must be a power of two");
+
+    std::array<std::array<TlbEntry, Way>, kSetCount> sets_;
+    std::array<std::list<uint32_t>, kSetCount> lru_;
+    size_t hits_, cnt_;
+
+    void Touch(uint32_t set, uint32_t way) {
+        if constexpr (P == CRP::LRU) {
+            LruPolicy::UpdateLines(way, lru_[set]);
+        } else {
+            bpLruPolicy::UpdateLines(way, sets_[set]);
+        }
+    }
+
+    // Запись страницы 4 КиБ лежит в наборе по VPN, мегастраницы — в наборе по VPN[1]
+    TlbEntry* Find(uint32_t vpn, uint32_t level) {
+        uint32_t key = vpn >> (level * VPN_LEN);
+        uint32_t set = key & (kSetCount - 1);
+        for (uint32_t i = 0; i < Way; ++i) {
+            if (sets_[set][i].is_valid && sets_[set][i].level == level && sets_[set][i].vpn == key) {
+                Touch(set, i);
+                return &sets_[set][i];
+            }
+        }
+        return nullptr;
+    }
+
+public:
+    Tlb() : hits_(0), cnt_(0) {};
+
+    TlbEntry* Lookup(uint32_t vpn) {
+        ++cnt_;
+        TlbEntry* entry = Find(vpn, 0);
+        if (entry == nullptr) {
+            entry = Find(vpn, 1);
+        }
+        if (entry != nullptr) {
+            ++hits_;
+        }
+        return entry;
+    }
+
+    // Повторное обращение к последней (MRU) записи: состояние вытеснения не меняется
+    void CountHit() {
+        ++cnt_;
+        ++hits_;
+    }
+
+    TlbEntry& Insert(uint32_t vpn, uint32_t ppn, uint32_t flags, uint32_t level) {
+        uint32_t key = vpn >> (level * VPN_LEN);
+        uint32_t set = key & (kSetCount - 1);
+        uint32_t way;
+        if constexpr (P == CRP::LRU) {
+            way = LruPolicy::GetNextLine(sets_[set], lru_[set]);
+        } else {
+            way = bpLruPolicy::GetNextLine(sets_[set]);
+        }
+        TlbEntry& entry = sets_[set][way];
+        entry.is_valid = true;
+        entry.level = level;
+        entry.vpn = key;
+        entry.ppn = ppn;
+        entry.flags = flags;
+        Touch(set, way);
+        return entry;
+    }
+
+    void Flush() {
+        for (uint32_t i = 0; i < kSetCount; ++i) {
+            for (auto& entry : sets_[i]) {
+                entry = TlbEntry();
+            }
+            lru_[i].clear();
+        }
+    }
+
+    double HitRate() const {
+        return 100.0 * hits_ / cnt_;
+    }
+};
+
+// Sv32: I-TLB/D-TLB и аппаратный обход таблицы страниц через кэш данных.
+// Для скорости хранится последняя трансляция каждого TLB (программный TLB хоста).
+class Mmu {
+private:
+    static constexpr uint32_t kPteV = 1 << 0;
+    static constexpr uint32_t kPteR = 1 << 1;
+    static constexpr uint32_t kPteW = 1 << 2;
+    static constexpr uint32_t kPteX = 1 << 3;
+    static constexpr uint32_t kPteA = 1 << 6;
+    static constexpr uint32_t kPteD = 1 << 7;
+
+    struct LastTranslation {
+        uint32_t vpn = UINT32_MAX;
+        uint32_t ppn = 0;
+        uint32_t flags = 0;
+    };
+
+    uint32_t satp_;
+    bool enabled_;
+    Tlb<ITLB_ENTRY_COUNT, ITLB_WAY, TLB_POLICY> itlb_;
+    Tlb<DTLB_ENTRY_COUNT, DTLB_WAY, TLB_POLICY> dtlb_;
+    LastTranslation last_inst_, last_data_;
+
+    static bool IsAllowed(uint32_t flags, Access access) {
+        if (access == Access::Fetch) {
+            return flags & kPteX;
+        } else if (access == Access::Load) {
+            return flags & kPteR;
+        }
+        return flags & kPteW;
+    }
+
+    // Запись в страницу, у которой в TLB ещё нет бита D, требует обхода для его установки
+    static bool NeedsDirty(uint32_t flags, Access access) {
+        return access == Access::Store && !(flags & kPteD);
+    }
+
+    // Биты A и D выставляются аппаратно: лист с новыми битами записывается обратно через
+    // кэш данных (D — только при записи). Для мегастраницы leaf_level = 1, ppn — её начало.
+    template <typename Cache, typename Memory>
+    bool Walk(uint32_t vpn, Access access, uint32_t& ppn, uint32_t& flags, uint32_t& leaf_level, Cache& cache, Memory& ram) {
+        uint64_t table = static_cast<uint64_t>(satp_ & ((1UL << 22UL) - 1UL)) << PAGE_OFFSET_LEN;
+        for (int level = 1; level >= 0; --level) {
+            uint32_t vpn_part = (vpn >> (level * VPN_LEN)) & ((1UL << VPN_LEN) - 1UL);
+            uint64_t pte_addres = table + vpn_part * sizeof(uint32_t);
+            if (pte_addres >= MEMORY_SIZE) { // таблица за пределами физической памяти
+                return false;
+            }
+            uint32_t pte = cache.template ReadFromCache<uint32_t>(pte_addres, true, ram);
+            if (!(pte & kPteV) || (!(pte & kPteR) && (pte & kPteW))) {
+                return false;
+            }
+            uint32_t pte_ppn = pte >> 10;
+            if (pte & (kPteR | kPteX)) {
+                if (level == 1 && (pte_ppn & ((1UL << VPN_LEN) - 1UL))) { // невыровненная мегастраница
+                    return false;
+                }
+                if (!IsAllowed(pte, access)) {
+                    return false;
+                }
+                uint32_t new_pte = pte | kPteA | (access == Access::Store ? kPteD : 0);
+                if (new_pte != pte) {
+                    cache.template WriteInCache<uint32_t>(pte_addres, true, new_pte, ram);
+                }
+                ppn = pte_ppn;
+                flags = new_pte & ((1UL << 8UL) - 1UL);
+                leaf_level = level;
+                return true;
+            }
+            table = static_cast<uint64_t>(pte_ppn) << PAGE_OFFSET_LEN;
+        }
+        return false;
+    }
+
+    template <typename T, typename Cache, typename Memory>
+    bool TranslateSlow(uint32_t vpn, Access access, LastTranslation& last, T& tlb, Cache& cache, Memory& ram) {
+        TlbEntry* entry = tlb.Lookup(vpn);
+        if (entry == nullptr || NeedsDirty(entry->flags, access)) {
+            uint32_t ppn, flags, level;
+            if (!Walk(vpn, access, ppn, flags, level, cache, ram)) {
+                last.vpn = UINT32_MAX;
+                return false;
+            }
+            if (entry == nullptr) {
+                entry = &tlb.Insert(vpn, ppn, flags, level);
+            } else {
+                entry->flags = flags;
+            }
+        }
+        uint32_t ppn = entry->GetPpn(vpn);
+        if (ppn >= (MEMORY_SIZE >> PAGE_OFFSET_LEN)) { // страница за пределами физической памяти
+            last.vpn = UINT32_MAX;
+            return false;
+        }
+        last.vpn = vpn;
+        last.ppn = ppn;
+        last.flags = entry->flags;
+        return true;
+    }
+
+public:
+    Mmu(uint32_t satp) : satp_(satp), enabled_(satp >> 31) {};
+
+    bool IsEnabled() const {
+        return enabled_;
+    }
+
+    template <typename Cache, typename Memory>
+    bool Translate(uint32_t& addres, Access access, Cache& cache, Memory& ram) {
+        if (!enabled_) {
+            return true;
+        }
+        uint32_t vpn = addres >> PAGE_OFFSET_LEN;
+        bool is_inst = access == Access::Fetch;
+        LastTranslation& last = is_inst ? last_inst_ : last_data_;
+        if (last.vpn == vpn && !NeedsDirty(last.flags, access)) {
+            if (is_inst) {
+                itlb_.CountHit();
+            } else {
+                dtlb_.CountHit();
+            }
+        } else {
+            bool ok = is_inst ? TranslateSlow(vpn, access, last, itlb_, cache, ram) : TranslateSlow(vpn, access, last, dtlb_, cache, ram);
+            if (!ok) {
+                std::cerr << "page fault: 0x" << std::hex << addres << std::dec << std::endl;
+                return false;
+            }
+        }
+        if (!IsAllowed(last.flags, access)) {
+            std::cerr << "page fault: 0x" << std::hex << addres << std::dec << std::endl;
+            return false;
+        }
+        addres = (last.ppn << PAGE_OFFSET_LEN) | (addres & (PAGE_SIZE - 1));
+        return true;
+    }
+
+    // Выборка из той же страницы, что и предыдущая: попадание в последнюю трансляцию I-TLB
+    void CountSamePageFetch() {
+        if (enabled_) {
+            itlb_.CountHit();
+        }
+    }
+
+    void Flush() {
+        itlb_.Flush();
+        dtlb_.Flush();
+        last_inst_ = LastTranslation();
+        last_data_ = LastTranslation();
+    }
+
+    void PrintRate() const {
+        if (enabled_) {
+            printf("\t%3.5f%%\t%3.5f%%", itlb_.HitRate(), dtlb_.HitRate());
+        }
+    }
+};
+
 class Proccesor {
 private:
     uint32_t pc;
     std::vector<fragment>& frag_;
     std::vector<uint32_t> regs_;
     bool need_to_write_;
+    Options options_;
+
+    // Пара из FusionTable исполняется без декодирования и повторной диспетчеризации.
+    // Второе слово лежит в той же странице (fetch_addres — физический адрес первого),
+    // поэтому учитывается как попадание в I-TLB и, если в той же линии, берётся из
+    // текущей линии выборки; счётчики совпадают с исполнением по одной инструкции.
+    template <typename Cache>
+    void ExecuteFused(FusionKind kind, uint32_t instr, uint32_t fetch_addres, Cache& cache, Mmu& mmu, RAM& ram, BranchPredictors* branches) {
+        mmu.CountSamePageFetch();
+        uint32_t next = cache.FetchFromCache(fetch_addres + 4, ram);
+        uint32_t rd = GetRd(instr);
+        uint32_t rs1 = GetRs1(instr);
+        if (kind == FusionKind::LuiAddi) {
+            regs_[rd] = GetImmUType(instr) + GetImmIType(next);
+            pc += 8;
+        } else if (kind == FusionKind::AuipcJalr) {
+            uint32_t jump_pc = pc + 4;
+            regs_[rd] = pc + GetImmUType(instr);
+            pc = (regs_[rd] + GetImmIType(next)) & (~1);
+            regs_[GetRd(next)] = jump_pc + 4;
+            if (branches) {
+                branches->Jump(jump_pc, pc, GetRd(next), rd, true);
+            }
+        } else {
+            uint32_t funct3 = GetFunct3(instr);
+            if (kind == FusionKind::AddiBne) { // addi
+                regs_[rd] = regs_[rs1] + GetImmIType(instr);
+            } else if (GetOpcode(instr) == 0b0110011) { // slt, sltu
+                if (funct3 == 0b010) {
+                    regs_[rd] = static_cast<int32_t>(regs_[rs1]) < static_cast<int32_t>(regs_[GetRs2(instr)]);
+                } else {
+                    regs_[rd] = regs_[rs1] < regs_[GetRs2(instr)];
+                }
+            } else { // slti, sltiu
+                if (funct3 == 0b010) {
+                    regs_[rd] = static_cast<int32_t>(regs_[rs1]) < GetImmIType(instr);
+                } else {
+                    regs_[rd] = regs_[rs1] < static_cast<uint32_t>(GetImmIType(instr));
+                }
+            }
+            uint32_t branch_pc = pc + 4;
+            bool taken = regs_[GetRs1(next)] != regs_[GetRs2(next)]; // bne
+            pc = taken ? branch_pc + GetImmBType(next) : branch_pc + 4;
+            if (branches) {
+                branches->Branch(branch_pc, branch_pc + GetImmBType(next), taken);
+            }
+        }
+    }
 
 public:
-    Proccesor(std::vector<fragment>& frag, const std::vector<uint32_t>& regs, bool write = true) : frag_(frag), need_to_write_(write) {
+    Proccesor(std::vector<fragment>& frag, const std::vector<uint32_t>& regs, const Options& options, bool write = true) : frag_(frag), need_to_write_(write), options_(options) {
         regs_.resize(33);
         regs_[0] = 0;
         std::copy(regs.begin() + 1, regs.end(), regs_.begin() + 1);
@@ -315,15 +788,53 @@ public:
     };
 
     template <CRP T>
-    void StartProgramming(DataToWrite& data) {
+    void StartProgramming(DataToWrite& data, BranchPredictors* branches = nullptr, IntervalStats* interval = nullptr) {
         RAM ram(frag_);
-        CacheController<T> cache;
+        CacheController<T> cache(options_.classify_misses, options_.fast_fetch);
+        Mmu mmu(options_.satp);
+        FusionTable fusion;
+        if (options_.fuse) {
+            fusion.Build(ram.GetData());
+        }
         uint32_t ra = regs_[1];
+        uint64_t instret = 0;
+        if (interval) {
+            interval->Begin(T);
+        }
+        // Завершение инструкции: x0, счётчик, снимки статистики и дамп по SIGUSR1
+        auto retire = [&]() {
+            regs_[0] = 0;
+            ++instret;
+            if (interval) {
+                interval->Tick(instret, cache.GetCounters());
+            }
+            if (dump_requested) {
+                dump_requested = 0;
+                DumpTotals(T, instret, cache.GetCounters());
+                if (interval) {
+                    interval->Flush();
+                }
+            }
+        };
         while (true) {
             if (pc == ra) {
                 break;
             }
-            uint32_t instr = cache.template ReadFromCache<uint32_t>(pc, false, ram);
+            uint32_t fetch_addres = pc;
+            if (!mmu.Translate(fetch_addres, Access::Fetch, cache, ram)) {
+                break;
+            }
+            uint32_t instr = cache.FetchFromCache(fetch_addres, ram);
+            if (options_.fuse) {
+                FusionKind fused = fusion.GetKind(fetch_addres);
+                if (fused != FusionKind::None && pc + 4 != ra) {
+                    ExecuteFused(fused, instr, fetch_addres, cache, mmu, ram, branches);
+                    fusion.CountHit(fused);
+                    ++instret;
+                    retire();
+                    continue;
+                }
+            }
             uint32_t opcode = GetOpcode(instr);
             uint32_t rd = GetRd(instr);
             uint32_t rs1 = GetRs1(instr);
@@ -440,109 +951,180 @@ public:
             } else if (opcode == 0b0010011 && funct3 == 0b000 && rd == 0 && rs1 == 0 && GetImmIType(instr) == 0) {
                 pc += 4;
             } else if (opcode == 0b1101111)  { // jal
+                uint32_t jump_pc = pc;
                 regs_[rd] = pc + 4;
                 pc += static_cast<int32_t>(GetImmJType(instr));
+                if (branches) {
+                    branches->Jump(jump_pc, pc, rd, 0, false);
+                }
             } else if (opcode == 0b1100111) { // jalr
                 uint32_t temp = pc + 4;
                 pc = (regs_[rs1] + GetImmIType(instr)) & (~1);
                 regs_[rd] = temp;
+                if (branches) {
+                    branches->Jump(temp - 4, pc, rd, rs1, true);
+                }
             } else if (opcode == 0b1100011) { // beq
+                uint32_t branch_pc = pc;
+                bool taken = false;
                 if (funct3 == 0b000) {
                     if (regs_[rs1] == regs_[rs2]) {
                         pc += static_cast<int32_t>(GetImmBType(instr));
+                        taken = true;
                     } else {
                         pc += 4;
                     }
                 } else if (funct3 == 0b001) { // bne
                     if (regs_[rs1] != regs_[rs2]) {
                         pc += static_cast<int32_t>(GetImmBType(instr));
+                        taken = true;
                     } else {
                         pc += 4;
                     }
                 }  else if (funct3 == 0b100) { // blt
                     if (static_cast<int32_t>(regs_[rs1]) < static_cast<int32_t>(regs_[rs2])) {
                         pc += static_cast<int32_t>(GetImmBType(instr));
+                        taken = true;
                     } else {
                         pc += 4;
                     }
                 } else if (funct3 == 0b101) { // bge
                     if (static_cast<int32_t>(regs_[rs1]) >= static_cast<int32_t>(regs_[rs2])) {
                         pc += static_cast<int32_t>(GetImmBType(instr));
+                        taken = true;
                     } else {
                         pc += 4;
                     }
                 } else if (funct3 == 0b110) { // bltu
                     if (regs_[rs1] < regs_[rs2]) {
                         pc += static_cast<int32_t>(GetImmBType(instr));
+                        taken = true;
                     } else {
                         pc += 4;
                     }
                 }  else if (funct3 == 0b111) { // bgeu
                     if (regs_[rs1] >= regs_[rs2]) {
                         pc += static_cast<int32_t>(GetImmBType(instr));
+                        taken = true;
                     } else {
                         pc += 4;
                     }
                 }
+                if (branches) {
+                    branches->Branch(branch_pc, branch_pc + GetImmBType(instr), taken);
+                }
             } else if (opcode == 0b0000011) {
                 if (funct3 == 0b000) { // lb
                     uint32_t addres = regs_[rs1] + GetImmIType(instr);
+                    if (!mmu.Translate(addres, Access::Load, cache, ram)) {
+                        break;
+                    }
                     regs_[rd] = static_cast<int32_t>(cache.template ReadFromCache<uint8_t>(addres, true, ram));
                     pc += 4;
                 } else if (funct3 == 0b001) { // lh
                     uint32_t addres = regs_[rs1] + GetImmIType(instr);
+                    if (!mmu.Translate(addres, Access::Load, cache, ram)) {
+                        break;
+                    }
                     regs_[rd] = static_cast<int32_t>(cache.template ReadFromCache<uint16_t>(addres, true, ram));
                     pc += 4;
                 } else if (funct3 == 0b010) { // lw
                     uint32_t addres = regs_[rs1] + GetImmIType(instr);
+                    if (!mmu.Translate(addres, Access::Load, cache, ram)) {
+                        break;
+                    }
                     regs_[rd] = static_cast<int32_t>(cache.template ReadFromCache<uint32_t>(addres, true, ram));
                     pc += 4;
                 } else if (funct3 == 0b100) { // lbu
                     uint32_t addres = regs_[rs1] + GetImmIType(instr);
+                    if (!mmu.Translate(addres, Access::Load, cache, ram)) {
+                        break;
+                    }
                     regs_[rd] = cache.template ReadFromCache<uint8_t>(addres, true, ram);
                     pc += 4;
                 }  else if (funct3 == 0b101) { // lhu
                     uint32_t addres = regs_[rs1] + GetImmIType(instr);
+                    if (!mmu.Translate(addres, Access::Load, cache, ram)) {
+                        break;
+                    }
                     regs_[rd] = cache.template ReadFromCache<uint16_t>(addres, true, ram);
                     pc += 4;
                 }
             } else if (opcode == 0b0100011) {
                 if (funct3  == 0b000) { // sb
                     uint32_t addres = regs_[rs1] + GetImmSType(instr);
+                    if (!mmu.Translate(addres, Access::Store, cache, ram)) {
+                        break;
+                    }
                     uint8_t value = regs_[rs2] & ((1UL << 8UL) - 1UL);
                     cache.template WriteInCache<uint8_t>(addres, true, value, ram);
+                    if (options_.fuse) {
+                        fusion.Invalidate(addres, sizeof(uint8_t));
+                    }
                     pc += 4;
                 } else if (funct3 == 0b001) { // sh
                     uint32_t addres = regs_[rs1] + GetImmSType(instr);
+                    if (!mmu.Translate(addres, Access::Store, cache, ram)) {
+                        break;
+                    }
                     uint16_t value = regs_[rs2] & ((1UL << 16UL) - 1UL);
                     cache.template WriteInCache<uint16_t>(addres, true, value, ram);
+                    if (options_.fuse) {
+                        fusion.Invalidate(addres, sizeof(uint16_t));
+                    }
                     pc += 4;
                 }  else if (funct3 == 0b010) { // sh
                     uint32_t addres = regs_[rs1] + GetImmSType(instr);
+                    if (!mmu.Translate(addres, Access::Store, cache, ram)) {
+                        break;
+                    }
                     cache.template WriteInCache<uint32_t>(addres, true, regs_[rs2], ram);
+                    if (options_.fuse) {
+                        fusion.Invalidate(addres, sizeof(uint32_t));
+                    }
                     pc += 4;
                 }
             } else if (instr == 0b00000000000000000000000001110011 || instr == 0b00000000000100000000000001110011) { // ecall or ebreak
                 break;
+            } else if (opcode == 0b1110011 && funct3 == 0b000 && funct7 == 0b0001001) { // sfence.vma
+                mmu.Flush();
+                pc += 4;
             } else if (opcode == 0b0001111) { // fence(NOP)
                 pc += 4; 
             }
+            retire();
         } 
+        if (interval) {
+            interval->End(instret, cache.GetCounters());
+        }
         cache.PrintRate();
+        mmu.PrintRate();
+        printf("\n");
+        if (options_.classify_misses) {
+            cache.PrintMissClasses();
+        }
+        if (options_.fuse) {
+            fusion.PrintStats(T);
+        }
          if (need_to_write_) {
             cache.ClearCache(ram);
             data.buff = ram.GetData();
             data.regs.resize(32);
             data.regs[0] = pc;
             std::copy(regs_.begin() + 1, regs_.end(), data.regs.begin() + 1);
-            FileWriter(data);
+            if (data.filename != "") {
+                FileWriter(data);
+            }
+            if (data.dump) {
+                data.dump->Write(data.regs, data.buff, ram.GetDirtyPages(), data.dump_ranges);
+            }
         }
     }
 };
 
 class Simulate {
 public:
-    Simulate(int argc, char* argv[]) : need_to_write(false), is_error(false) {
+    Simulate(int argc, char* argv[]) : is_error(false), need_to_write(false), predict_branches_(false) {
         Parser pr;
         Data data = pr.Parse(argc, argv); 
         BinParser bin_pr(data.filename1);
@@ -551,28 +1133,61 @@ public:
         data_.addres = data.begin_addres;
         data_.len = data.size;
         data_.filename = data.filename2;
-        if (data.filename2 != "") {
+        options_.classify_misses = data.classify_misses;
+        options_.satp = data.satp;
+        options_.fuse = data.fuse;
+        options_.fast_fetch = data.fast_fetch;
+        predict_branches_ = data.predict_branches;
+        data_.dump_ranges = data.dump_ranges;
+        if (data.filename2 != "" || data.dump_filename != "") {
             need_to_write = true;
         }
         error = data.error_name;
         is_error = data.error;
+        if (!is_error && data.stats_filename != "") {
+            interval_ = std::make_unique<IntervalStats>(data.stats_filename, data.stats_period, data.stats_by_access);
+            if (!interval_->IsOpen()) {
+                error = "Не удалось открыть файл статистики " + data.stats_filename + "\n";
+                is_error = true;
+            }
+        }
+        if (!is_error && data.dump_filename != "") {
+            dump_ = std::make_unique<DumpWriter>(data.dump_filename, data.compress);
+            data_.dump = dump_.get();
+            if (!dump_->IsOpen()) {
+                error = "Не удалось открыть файл дампа " + data.dump_filename + "\n";
+                is_error = true;
+            }
+        }
     }
 
     void Start() {
         if (is_error) {
             std::cerr << error << std::endl;
         } else {
-            printf("replacement\thit rate\thit rate (inst)\thit rate (data)\n");
+            printf("replacement\thit rate\thit rate (inst)\thit rate (data)");
+            if (options_.satp >> 31) {
+                printf("\thit rate (itlb)\thit rate (dtlb)");
+            }
+            printf("\n");
+            // Предсказание переходов не зависит от политики кэша, поэтому собирается только в прогоне с LRU
+            BranchPredictors predictors;
+            BranchPredictors* branches = predict_branches_ ? &predictors : nullptr;
+            IntervalStats* interval = interval_.get();
+            InstallDumpHandler();
             if (need_to_write) {
-                Proccesor cpu(frag_, regs_);
-                cpu.StartProgramming<CRP::LRU>(data_);
-                Proccesor cpu2(frag_, regs_, false);
-                cpu2.StartProgramming<CRP::pLRU>(data_);
+                Proccesor cpu(frag_, regs_, options_);
+                cpu.StartProgramming<CRP::LRU>(data_, branches, interval);
+                Proccesor cpu2(frag_, regs_, options_, false);
+                cpu2.StartProgramming<CRP::pLRU>(data_, nullptr, interval);
             } else {
-                Proccesor cpu(frag_, regs_, false);
-                cpu.StartProgramming<CRP::LRU>(data_);
-                Proccesor cpu2(frag_, regs_, false);
-                cpu2.StartProgramming<CRP::pLRU>(data_);
+                Proccesor cpu(frag_, regs_, options_, false);
+                cpu.StartProgramming<CRP::LRU>(data_, branches, interval);
+                Proccesor cpu2(frag_, regs_, options_, false);
+                cpu2.StartProgramming<CRP::pLRU>(data_, nullptr, interval);
+            }
+            if (branches) {
+                branches->PrintStats();
             }
         }
     }
@@ -582,6 +1197,10 @@ private:
     std::string error;
     bool need_to_write;
     DataToWrite data_;
+    Options options_;
+    bool predict_branches_;
+    std::unique_ptr<IntervalStats> interval_;
+    std::unique_ptr<DumpWriter> dump_;
     std::vector<fragment> frag_;
     std::vector<uint32_t> regs_;
 };
@@ -0,0 +1,175 @@
+#pragma once
+
+#include "const.hpp"
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace RiscV {
+
+struct CacheCounters {
+    uint64_t hits_inst = 0;
+    uint64_t hits_data = 0;
+    uint64_t inst_cnt = 0;
+    uint64_t data_cnt = 0;
+};
+
+// Выставляется по SIGUSR1, проверяется в цикле исполнения
+inline volatile std::sig_atomic_t dump_requested = 0;
+
+inline void InstallDumpHandler() {
+    std::signal(SIGUSR1, [](int) {
+        dump_requested = 1;
+    });
+}
+
+inline void DumpTotals(CRP policy, uint64_t instret, const CacheCounters& counters) {
+    fprintf(stderr, "%11s\tinstructions %llu\tinst %llu/%llu\tdata %llu/%llu\n", GetPolicyName(policy),
+            static_cast<unsigned long long>(instret),
+            static_cast<unsigned long long>(counters.hits_inst), static_cast<unsigned long long>(counters.inst_cnt),
+            static_cast<unsigned long long>(counters.hits_data), static_cast<unsigned long long>(counters.data_cnt));
+}
+
+class BufferedWriter {
+private:
+    static constexpr size_t kBufferSize = 1 << 16;
+
+    FILE* file_;
+    std::vector<char> buffer_;
+
+public:
+    BufferedWriter(const std::string& filename) : file_(fopen(filename.c_str(), "wb")) {
+        buffer_.reserve(kBufferSize);
+    };
+
+    BufferedWriter(const BufferedWriter&) = delete;
+    BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+    ~BufferedWriter() {
+        Flush();
+        if (file_ != nullptr) {
+            fclose(file_);
+        }
+    }
+
+    bool IsOpen() const {
+        return file_ != nullptr;
+    }
+
+    void Write(const void* data, size_t size) {
+        if (buffer_.size() + size > kBufferSize) {
+            Flush();
+        }
+        const char* bytes = static_cast<const char*>(data);
+        buffer_.insert(buffer_.end(), bytes, bytes + size);
+    }
+
+    template <typename T>
+    void Write(const T& value) {
+        Write(&value, sizeof(T));
+    }
+
+    void Flush() {
+        if (file_ != nullptr && !buffer_.empty()) {
+            fwrite(buffer_.data(), 1, buffer_.size(), file_);
+            fflush(file_);
+        }
+        buffer_.clear();
+    }
+};
+
+// Снимки статистики каждые N инструкций или N обращений к кэшу.
+// Формат CSV, если имя файла оканчивается на ".csv", иначе бинарные записи:
+// policy (uint8), instructions (uint64), hit rate inst, hit rate data, MIPS (double).
+class IntervalStats {
+private:
+    // Во время долгого прогона снимки сбрасываются в файл не реже раза в секунду
+    static constexpr std::chrono::seconds kFlushPeriod{1};
+
+    BufferedWriter writer_;
+    uint64_t period_;
+    bool by_access_;
+    bool is_csv_;
+    CRP policy_;
+    uint64_t next_;
+    uint64_t last_instret_;
+    CacheCounters last_;
+    std::chrono::steady_clock::time_point last_time_;
+    std::chrono::steady_clock::time_point last_flush_;
+
+    static double Rate(uint64_t hits, uint64_t cnt) {
+        return cnt == 0 ? 0.0 : 100.0 * hits / cnt;
+    }
+
+    void Record(uint64_t instret, const CacheCounters& counters) {
+        auto now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - last_time_).count();
+        double inst_rate = Rate(counters.hits_inst - last_.hits_inst, counters.inst_cnt - last_.inst_cnt);
+        double data_rate = Rate(counters.hits_data - last_.hits_data, counters.data_cnt - last_.data_cnt);
+        double mips = seconds > 0 ? (instret - last_instret_) / seconds / 1e6 : 0.0;
+        if (is_csv_) {
+            char line[128];
+            int len = snprintf(line, sizeof(line), "%s,%llu,%.5f,%.5f,%.3f\n", GetPolicyName(policy_),
+                               static_cast<unsigned long long>(instret), inst_rate, data_rate, mips);
+            writer_.Write(line, len);
+        } else {
+            writer_.Write(static_cast<uint8_t>(policy_));
+            writer_.Write(instret);
+            writer_.Write(inst_rate);
+            writer_.Write(data_rate);
+            writer_.Write(mips);
+        }
+        last_instret_ = instret;
+        last_ = counters;
+        last_time_ = now;
+        if (now - last_flush_ >= kFlushPeriod) {
+            Flush();
+        }
+    }
+
+public:
+    IntervalStats(const std::string& filename, uint64_t period, bool by_access)
+        : writer_(filename), period_(period), by_access_(by_access), policy_(CRP::LRU), next_(period), last_instret_(0), last_flush_(std::chrono::steady_clock::now()) {
+        is_csv_ = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".csv") == 0;
+        if (is_csv_) {
+            const char header[] = "replacement,instructions,hit rate (inst),hit rate (data),MIPS\n";
+            writer_.Write(header, sizeof(header) - 1);
+        }
+    }
+
+    bool IsOpen() const {
+        return writer_.IsOpen();
+    }
+
+    void Begin(CRP policy) {
+        policy_ = policy;
+        next_ = period_;
+        last_instret_ = 0;
+        last_ = CacheCounters();
+        last_time_ = std::chrono::steady_clock::now();
+    }
+
+    // Вызывается после каждой инструкции
+    void Tick(uint64_t instret, const CacheCounters& counters) {
+        uint64_t progress = by_access_ ? counters.inst_cnt + counters.data_cnt : instret;
+        if (progress >= next_) {
+            Record(instret, counters);
+            next_ = progress + period_;
+        }
+    }
+
+    void Flush() {
+        writer_.Flush();
+        last_flush_ = std::chrono::steady_clock::now();
+    }
+
+    void End(uint64_t instret, const CacheCounters& counters) {
+        if (instret != last_instret_) {
+            Record(instret, counters);
+        }
+        writer_.Flush();
+    }
+};
+}
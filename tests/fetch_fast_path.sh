@@ -0,0 +1,38 @@
+#!/bin/sh
+# Сверка быстрого пути выборки инструкций с обычным (-slow-fetch):
+# статистика кэша, TLB и классификация промахов, а также дамп -o должны совпадать.
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+CXX=${CXX:-g++}
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+$CXX -std=c++20 -O2 "$ROOT/main.cpp" -o "$WORK/riscv_emu"
+
+failed=0
+
+check() {
+    image=$1
+    shift
+    "$WORK/riscv_emu" -i "$image" -c "$@" -o "$WORK/fast.bin" 0 131072 > "$WORK/fast.txt"
+    "$WORK/riscv_emu" -i "$image" -c "$@" -slow-fetch -o "$WORK/slow.bin" 0 131072 > "$WORK/slow.txt"
+    if diff "$WORK/fast.txt" "$WORK/slow.txt" > /dev/null && cmp -s "$WORK/fast.bin" "$WORK/slow.bin"; then
+        echo "ok      $(basename "$image") $*"
+    else
+        echo "FAILED  $(basename "$image") $*"
+        diff "$WORK/fast.txt" "$WORK/slow.txt" || true
+        failed=1
+    fi
+}
+
+check "$ROOT/task.bin"
+check "$ROOT/tests/mm.bin"
+check "$ROOT/tests/sweep.bin"
+check "$ROOT/tests/mm_vm.bin" -vm 8000001C
+check "$ROOT/tests/sweep_vm.bin" -vm 8000001C
+check "$ROOT/tests/sweep_mega.bin" -vm 8000001C
+check "$ROOT/tests/mm.bin" -fuse
+check "$ROOT/tests/mm_vm.bin" -vm 8000001C -fuse
+
+exit $failed
@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+# Сборка тестовых образов из mm.s и sweep.s (нужны llvm-mc, ld.lld, llvm-objcopy).
+# Формат образа: 32 регистра (x0 — PC), затем фрагменты (адрес, длина, данные).
+# Варианты *_vm содержат таблицы страниц Sv32: корневая в 0x1C000 (satp = 8000001C).
+import os
+import struct
+import subprocess
+
+LLVM_MC = os.environ.get('LLVM_MC', 'llvm-mc')
+LD_LLD = os.environ.get('LD_LLD', 'ld.lld')
+OBJCOPY = os.environ.get('LLVM_OBJCOPY', 'llvm-objcopy')
+BASE = 0x1000
+ROOT_TABLE = 0x1C000
+LEAF_TABLE = 0x1D000
+
+
+def assemble(name, tmp):
+    obj, elf, raw = (os.path.join(tmp, name + ext) for ext in ('.o', '.elf', '.raw'))
+    subprocess.check_call([LLVM_MC, '-triple=riscv32', '-mattr=+m,-relax', '-filetype=obj', name + '.s', '-o', obj])
+    subprocess.check_call([LD_LLD, '-Ttext=0x%x' % BASE, '-e', '0x%x' % BASE, obj, '-o', elf])
+    subprocess.check_call([OBJCOPY, '-O', 'binary', '-j', '.text', elf, raw])
+    with open(raw, 'rb') as f:
+        return f.read()
+
+
+def write_image(name, code, data=()):
+    regs = [0] * 32
+    regs[0] = BASE
+    regs[1] = 4  # адрес остановки, недостижим
+    regs[2] = 0x1F000
+    out = b''.join(struct.pack('<I', r) for r in regs)
+    out += struct.pack('<II', BASE, len(code)) + code
+    for addr, blob in data:
+        out += struct.pack('<II', addr, len(blob)) + blob
+    with open(name + '.bin', 'wb') as f:
+        f.write(out)
+
+
+def page_tables(mega=False):
+    root, leaf = bytearray(4096), bytearray(4096)
+    if mega:
+        struct.pack_into('<I', root, 0, 0xF)  # мегастраница 0 -> 0, RWX
+    else:
+        struct.pack_into('<I', root, 0, ((LEAF_TABLE >> 12) << 10) | 0x1)
+        for page in range(32):
+            flags = 0x1 | 0x2 | (0x8 if page == BASE >> 12 else 0x4)  # код R|X, остальное R|W
+            struct.pack_into('<I', leaf, page * 4, (page << 10) | flags)
+    return [(ROOT_TABLE, bytes(root)), (LEAF_TABLE, bytes(leaf))]
+
+
+def main():
+    os.chdir(os.path.dirname(os.path.abspath(__file__)))
+    tmp = os.path.join('/tmp', 'riscv_images')
+    os.makedirs(tmp, exist_ok=True)
+    a = b''.join(struct.pack('<I', i % 7 + 1) for i in range(256))
+    b = b''.join(struct.pack('<I', i % 5 + 2) for i in range(256))
+    matrices = [(0x8000, a), (0x9000, b)]
+
+    mm = assemble('mm', tmp)
+    write_image('mm', mm, matrices)
+    write_image('mm_vm', mm, matrices + page_tables())
+    sweep = assemble('sweep', tmp)
+    write_image('sweep', sweep)
+    write_image('sweep_vm', sweep, page_tables())
+    write_image('sweep_mega', sweep, page_tables(True))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,37 @@
+
+  li s0, 0x8000
+  li s1, 0x9000
+  li s2, 0xA000
+  li t6, 16
+  li a0, 0
+outer:
+  li a1, 0
+mid:
+  li a2, 0
+  li a3, 0
+inner:
+  slli t0, a0, 4
+  add t0, t0, a2
+  slli t0, t0, 2
+  add t0, t0, s0
+  lw t1, 0(t0)
+  slli t2, a2, 4
+  add t2, t2, a1
+  slli t2, t2, 2
+  add t2, t2, s1
+  lw t3, 0(t2)
+  mul t4, t1, t3
+  add a3, a3, t4
+  addi a2, a2, 1
+  blt a2, t6, inner
+  slli t0, a0, 4
+  add t0, t0, a1
+  slli t0, t0, 2
+  add t0, t0, s2
+  sw a3, 0(t0)
+  addi a1, a1, 1
+  slt t5, a1, t6
+  bne t5, zero, mid
+  addi a0, a0, 1
+  blt a0, t6, outer
+  ecall
@@ -0,0 +1,29 @@
+
+  li s0, 0x4000
+  li s3, 40
+rep:
+  li s1, 0
+sweep:
+  slli t0, s1, 10
+  add t0, t0, s0
+  lw t1, 0(t0)
+  addi t1, t1, 3
+  sw t1, 0(t0)
+  mv a0, s1
+  call fn
+  addi s1, s1, 1
+  li t2, 24
+  blt s1, t2, sweep
+  addi s3, s3, -1
+  bne s3, zero, rep
+  ecall
+fn:
+  andi a0, a0, 3
+  beq a0, zero, fn_one
+  addi a0, a0, 1
+  ret
+fn_one:
+  lui a1, 0x12345
+  addi a1, a1, 0x678
+  sb a1, 0x100(s0)
+  ret